@@ -0,0 +1,383 @@
+// compact_sphere_list.h
+#ifndef COMPACT_SPHERE_LIST_H
+#define COMPACT_SPHERE_LIST_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Allocator returning cache-line-aligned memory; plain operator new only guarantees
+// alignof(max_align_t) before C++17.
+template <class T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+    static const size_t alignment = 64;
+
+    CacheAlignedAllocator() {}
+    template <class U> CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        // Over-allocate and keep the original pointer just before the aligned address.
+        if (n > (std::numeric_limits<size_t>::max() - alignment - sizeof(void*)) / sizeof(T))
+            throw std::bad_alloc();
+        char* raw = static_cast<char*>(::operator new(n * sizeof(T) + alignment + sizeof(void*)));
+        auto addr = reinterpret_cast<std::uintptr_t>(raw + sizeof(void*));
+        addr = (addr + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+        reinterpret_cast<void**>(addr)[-1] = raw;
+        return reinterpret_cast<T*>(addr);
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+template <class T, class U>
+bool operator==(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return true; }
+
+template <class T, class U>
+bool operator!=(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return false; }
+
+// Compact storage for very large sphere scenes.
+//
+// Spheres are grouped into blocks of up to 16 that are spatially close and of similar
+// size. Each block has a 32-byte header with its float bounds and the index of its
+// first sphere. The spheres themselves live in structure-of-arrays form: 16-bit centers
+// and radii quantized against their block's bounds, plus a 16-bit index into a shared
+// material palette. Every array is contiguous and cache-line aligned, and a block's
+// spheres are a run of consecutive entries, so a sphere costs 10 bytes plus its share
+// of the block header: 12 bytes in a full block and 42 bytes when alone.
+//
+// Blocks never mix radius octaves and are closed early when their extent would make
+// the center quantization error exceed max_relative_error of their smallest radius.
+// Spheres are added once and packed by a single build().
+class CompactSphereList : public Hittable {
+public:
+    static const int block_size = 16;
+    static const int quant_max = 65535;
+    static constexpr double max_relative_error = 1e-3;
+
+    struct alignas(32) BlockHeader {
+        float origin[3];        // Minimum corner of the centers' bounds
+        float scale[3];         // Center quantization step per axis
+        float radius_scale;     // Radius quantization step
+        std::uint32_t first;    // Index of the block's first sphere
+    };
+
+    CompactSphereList() : built(false) {}
+
+    // Reserve staging space when the sphere count is known up front.
+    void reserve(size_t count) { pending.reserve(count); }
+
+    // Stage a sphere; it becomes visible to hit() after build().
+    void add(const Point3& center, double radius, std::shared_ptr<Material> m) {
+        if (built)
+            throw std::logic_error("CompactSphereList: add() after build()");
+
+        PendingSphere s;
+        s.key = 0;
+        for (int a = 0; a < 3; a++)
+            s.center[a] = static_cast<float>(center[a]);
+        s.radius = static_cast<float>(fabs(radius));
+        s.material = material_id(m);
+        pending.push_back(s);
+    }
+
+    // Pack all staged spheres into quantized blocks and release the staging copies.
+    // May only be called once.
+    void build();
+
+    size_t size() const { return cx.size(); }
+
+    // Blocks exclude the sentinel header that closes the last run.
+    size_t block_count() const { return headers.empty() ? 0 : headers.size() - 1; }
+
+    // Bytes used by the packed scene (excluding the shared material palette).
+    size_t memory_bytes() const {
+        return headers.size() * sizeof(BlockHeader) + size() * 5 * sizeof(std::uint16_t);
+    }
+
+    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+
+private:
+    template <class T>
+    using AlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+    // Staged sphere in single precision, with its sort key filled in by build().
+    struct PendingSphere {
+        std::uint64_t key;
+        float center[3];
+        float radius;
+        std::uint16_t material;
+    };
+
+    std::uint16_t material_id(const std::shared_ptr<Material>& m) {
+        auto it = material_ids.find(m.get());
+        if (it != material_ids.end())
+            return it->second;
+
+        if (materials.size() > quant_max)
+            throw std::length_error("CompactSphereList: more than 65536 materials");
+
+        auto id = static_cast<std::uint16_t>(materials.size());
+        materials.push_back(m);
+        material_ids[m.get()] = id;
+        return id;
+    }
+
+    static std::uint16_t quantize(double value, double step) {
+        if (step <= 0) return 0;
+        auto q = std::floor(value / step + 0.5);
+        return static_cast<std::uint16_t>(clamp(q, 0.0, quant_max));
+    }
+
+    static float round_down(double x) {
+        auto f = static_cast<float>(x);
+        return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float round_up(double x) {
+        auto f = static_cast<float>(x);
+        return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    Point3 sphere_center(const BlockHeader& h, size_t i) const {
+        return Point3(
+            h.origin[0] + cx[i] * static_cast<double>(h.scale[0]),
+            h.origin[1] + cy[i] * static_cast<double>(h.scale[1]),
+            h.origin[2] + cz[i] * static_cast<double>(h.scale[2])
+        );
+    }
+
+    size_t run_end(size_t first) const;
+    void pack_block(size_t first, size_t end, BlockHeader& h);
+
+    static bool hit_bounds(const BlockHeader& h, const Point3& o, const Vec3& inv_dir,
+                           double t_min, double t_max);
+
+    std::vector<PendingSphere> pending;
+    std::vector<std::shared_ptr<Material>> materials;
+    std::unordered_map<const Material*, std::uint16_t> material_ids;
+
+    AlignedVector<BlockHeader> headers;     // One per block, plus a sentinel
+    AlignedVector<std::uint16_t> cx, cy, cz;
+    AlignedVector<std::uint16_t> radius;
+    AlignedVector<std::uint16_t> material;
+    bool built;
+};
+
+// Spread the low 21 bits of v so that two zero bits separate each, for 3D Morton codes.
+inline std::uint64_t morton_spread(std::uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+// Greedily extend a block from pending[first] while it stays within one radius octave,
+// holds at most block_size spheres and keeps the quantization step within budget.
+inline size_t CompactSphereList::run_end(size_t first) const {
+    const auto& s0 = pending[first];
+    auto bucket = s0.key >> 51;
+    double run_min[3], run_max[3];
+    for (int a = 0; a < 3; a++)
+        run_min[a] = run_max[a] = s0.center[a];
+    double run_rmin = s0.radius;
+
+    size_t k = first + 1;
+    for (; k < pending.size() && k - first < block_size; k++) {
+        const auto& s = pending[k];
+        if (s.key >> 51 != bucket)
+            break;
+
+        double extent = 0;
+        for (int a = 0; a < 3; a++)
+            extent = fmax(extent, fmax(run_max[a], s.center[a]) - fmin(run_min[a], s.center[a]));
+        if (extent / quant_max > 2 * max_relative_error * fmin(run_rmin, s.radius))
+            break;
+
+        for (int a = 0; a < 3; a++) {
+            run_min[a] = fmin(run_min[a], s.center[a]);
+            run_max[a] = fmax(run_max[a], s.center[a]);
+        }
+        run_rmin = fmin(run_rmin, s.radius);
+    }
+    return k;
+}
+
+inline void CompactSphereList::pack_block(size_t first, size_t end, BlockHeader& h) {
+    double bmin[3] = { infinity, infinity, infinity };
+    double bmax[3] = { -infinity, -infinity, -infinity };
+    double rmax = 0;
+    for (size_t i = first; i < end; i++) {
+        const auto& s = pending[i];
+        for (int a = 0; a < 3; a++) {
+            bmin[a] = fmin(bmin[a], s.center[a]);
+            bmax[a] = fmax(bmax[a], s.center[a]);
+        }
+        rmax = fmax(rmax, s.radius);
+    }
+
+    // Round the float bounds outward and quantize against the stored values, so the
+    // decoded spheres always stay inside the bounds that hit_bounds() tests.
+    for (int a = 0; a < 3; a++) {
+        h.origin[a] = round_down(bmin[a]);
+        h.scale[a] = round_up((bmax[a] - h.origin[a]) / quant_max);
+    }
+    h.radius_scale = round_up(rmax / quant_max);
+    h.first = static_cast<std::uint32_t>(first);
+
+    for (size_t i = first; i < end; i++) {
+        const auto& s = pending[i];
+        cx[i] = quantize(s.center[0] - static_cast<double>(h.origin[0]), h.scale[0]);
+        cy[i] = quantize(s.center[1] - static_cast<double>(h.origin[1]), h.scale[1]);
+        cz[i] = quantize(s.center[2] - static_cast<double>(h.origin[2]), h.scale[2]);
+        radius[i] = quantize(s.radius, h.radius_scale);
+        material[i] = s.material;
+    }
+}
+
+inline void CompactSphereList::build() {
+    if (built)
+        throw std::logic_error("CompactSphereList: build() called twice");
+    built = true;
+
+    if (pending.size() > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("CompactSphereList: more than 2^32 spheres");
+
+    // Order spheres by radius octave, then along a Morton curve over the scene bounds,
+    // so that each block has a tight spatial extent and a narrow radius range.
+    double lo[3] = { infinity, infinity, infinity };
+    double hi[3] = { -infinity, -infinity, -infinity };
+    for (const auto& s : pending) {
+        for (int a = 0; a < 3; a++) {
+            lo[a] = fmin(lo[a], s.center[a]);
+            hi[a] = fmax(hi[a], s.center[a]);
+        }
+    }
+
+    for (auto& s : pending) {
+        std::uint64_t code = 0;
+        for (int a = 0; a < 3; a++) {
+            auto extent = hi[a] - lo[a];
+            auto cell = extent > 0 ? (s.center[a] - lo[a]) / extent * 0x1ffff : 0.0;
+            code |= morton_spread(static_cast<std::uint64_t>(cell)) << a;
+        }
+        int octave = s.radius > 0 ? std::ilogb(s.radius) : -1024;
+        auto bucket = static_cast<std::uint64_t>(clamp(octave + 1024, 0, 2047));
+        s.key = (bucket << 51) | code;
+    }
+    std::sort(pending.begin(), pending.end(),
+        [](const PendingSphere& a, const PendingSphere& b) { return a.key < b.key; });
+
+    // Count the blocks first so that every array is allocated exactly once.
+    size_t count = 0;
+    for (size_t first = 0; first < pending.size(); first = run_end(first))
+        count++;
+
+    const size_t n = pending.size();
+    headers.resize(count + 1);
+    cx.resize(n);
+    cy.resize(n);
+    cz.resize(n);
+    radius.resize(n);
+    material.resize(n);
+
+    size_t b = 0;
+    for (size_t first = 0; first < n; b++) {
+        size_t end = run_end(first);
+        pack_block(first, end, headers[b]);
+        first = end;
+    }
+    headers[count] = BlockHeader();
+    headers[count].first = static_cast<std::uint32_t>(n);
+
+    std::vector<PendingSphere>().swap(pending);
+}
+
+// Slab test against the block's centers bounds grown by its largest radius.
+inline bool CompactSphereList::hit_bounds(const BlockHeader& h, const Point3& o,
+                                          const Vec3& inv_dir, double t_min, double t_max) {
+    double rmax = quant_max * static_cast<double>(h.radius_scale);
+
+    for (int a = 0; a < 3; a++) {
+        double lo = h.origin[a] - rmax;
+        double hi = h.origin[a] + quant_max * static_cast<double>(h.scale[a]) + rmax;
+        double t0 = (lo - o[a]) * inv_dir[a];
+        double t1 = (hi - o[a]) * inv_dir[a];
+        if (inv_dir[a] < 0) std::swap(t0, t1);
+
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_max < t_min)
+            return false;
+    }
+    return true;
+}
+
+inline bool CompactSphereList::hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const {
+    const Point3 origin = r.origin();
+    const Vec3 direction = r.direction();
+    const Vec3 inv_dir(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z());
+    const auto a = direction.length_squared();
+
+    const BlockHeader* hit_block = nullptr;
+    size_t hit_index = 0;
+    auto closest_so_far = t_max;
+
+    const size_t blocks = block_count();
+    for (size_t b = 0; b < blocks; b++) {
+        const auto& h = headers[b];
+        if (!hit_bounds(h, origin, inv_dir, t_min, closest_so_far))
+            continue;
+
+        const size_t end = headers[b + 1].first;
+        for (size_t i = h.first; i < end; i++) {
+            double rad = radius[i] * static_cast<double>(h.radius_scale);
+            Vec3 oc = origin - sphere_center(h, i);
+            auto half_b = dot(oc, direction);
+            auto c = oc.length_squared() - rad * rad;
+            auto discriminant = half_b * half_b - a * c;
+            if (discriminant < 0)
+                continue;
+
+            // Find the nearest root that lies in the acceptable range.
+            auto sqrt_discriminant = sqrt(discriminant);
+            auto root = (-half_b - sqrt_discriminant) / a;
+            if (root < t_min || root > closest_so_far) {
+                root = (-half_b + sqrt_discriminant) / a;
+                if (root < t_min || root > closest_so_far)
+                    continue;
+            }
+
+            closest_so_far = root;
+            hit_block = &h;
+            hit_index = i;
+        }
+    }
+
+    if (!hit_block)
+        return false;
+
+    // Only decode the full hit record for the closest sphere.
+    double rad = radius[hit_index] * static_cast<double>(hit_block->radius_scale);
+    rec.t = closest_so_far;
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, (rec.p - sphere_center(*hit_block, hit_index)) / rad);
+    rec.material_ptr = materials[material[hit_index]];
+    return true;
+}
+
+#endif // COMPACT_SPHERE_LIST_H
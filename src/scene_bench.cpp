@@ -0,0 +1,223 @@
+// scene_bench.cpp
+//
+// Compares the HittableList of shared_ptr<Sphere> layout against CompactSphereList:
+// memory per object, closest-hit rays per second, and how often the two layouts
+// disagree on which material (or whether anything) a ray hits.
+//
+// Usage: scene_bench [object_count] [ray_count]
+//        scene_bench --check    Compare both layouts on the main.cpp scene and fail
+//                               if they disagree on more rays than the tolerance, or
+//                               if the compact layout ever uses more bytes per object.
+
+#include "rtweekend.h"
+#include "vec3.h"
+#include "ray.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "compact_sphere_list.h"
+#include "camera.h"
+#include "material.h"
+#include "scene.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Largest fraction of rays allowed to hit a different material in --check mode.
+const double max_mismatch_fraction = 1e-4;
+
+struct Comparison {
+    size_t rays;
+    size_t hits;
+    size_t mismatches;  // Rays whose hit/miss result or material differs
+    double dt_sum;      // Sum of |t_list - t_compact| over rays that agree
+    double dt_max;
+};
+
+double rays_per_sec(const Hittable& world, const std::vector<Ray>& rays) {
+    HitRecord rec;
+    size_t hits = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& r : rays) {
+        if (world.hit(r, 0.001, infinity, rec))
+            hits++;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Keep the loop from being optimized away.
+    if (hits > rays.size())
+        std::cerr << hits;
+    return rays.size() / elapsed.count();
+}
+
+Comparison compare(const Hittable& list, const Hittable& compact, const std::vector<Ray>& rays) {
+    Comparison result = { rays.size(), 0, 0, 0, 0 };
+
+    for (const auto& r : rays) {
+        HitRecord a, b;
+        bool hit_a = list.hit(r, 0.001, infinity, a);
+        bool hit_b = compact.hit(r, 0.001, infinity, b);
+
+        if (hit_a != hit_b || (hit_a && a.material_ptr != b.material_ptr)) {
+            result.mismatches++;
+        }
+        else if (hit_a) {
+            auto dt = fabs(a.t - b.t);
+            result.hits++;
+            result.dt_sum += dt;
+            result.dt_max = fmax(result.dt_max, dt);
+        }
+    }
+    return result;
+}
+
+CompactSphereList pack(const HittableList& list) {
+    CompactSphereList compact;
+    compact.reserve(list.objects.size());
+    for (const auto& object : list.objects) {
+        auto sphere = std::dynamic_pointer_cast<Sphere>(object);
+        compact.add(sphere->center, sphere->radius, sphere->material_ptr);
+    }
+    compact.build();
+    return compact;
+}
+
+// Random spheres in a cube, sharing a small material palette.
+HittableList random_spheres(size_t object_count, double extent, double min_radius, double max_radius) {
+    const int material_count = 64;
+    std::vector<std::shared_ptr<Material>> palette;
+    for (int i = 0; i < material_count; i++)
+        palette.push_back(std::make_shared<Lambertian>(Color::random()));
+
+    HittableList list;
+    for (size_t i = 0; i < object_count; i++) {
+        Point3 center = Vec3::random(-extent, extent);
+        auto radius = random_double(min_radius, max_radius);
+        auto material = palette[static_cast<size_t>(random_double() * material_count)];
+        list.add(std::make_shared<Sphere>(center, radius, material));
+    }
+    return list;
+}
+
+// Per-object cost of the current layout: the vector slot, the Sphere itself and the
+// make_shared control block header (two reference counts and a vtable pointer).
+// Allocator bookkeeping per heap block is not included.
+double list_bytes_per_object() {
+    const size_t control_block = 2 * sizeof(int) + sizeof(void*);
+    return sizeof(std::shared_ptr<Hittable>) + sizeof(Sphere) + control_block;
+}
+
+double compact_bytes_per_object(const CompactSphereList& compact) {
+    return static_cast<double>(compact.memory_bytes()) / compact.size();
+}
+
+void report(const Comparison& c) {
+    std::cout << "mismatched rays: " << c.mismatches << " of " << c.rays
+              << ", mean |dt| per hit: " << c.dt_sum / (c.hits ? c.hits : 1)
+              << ", max |dt|: " << c.dt_max << '\n';
+}
+
+int check_main_scene() {
+    HittableList list = random_scene();
+    CompactSphereList compact = pack(list);
+
+    // Same camera as main.cpp
+    const auto aspect_ratio = 16.0 / 9.0;
+    Camera cam(Point3(13, 2, 3), Point3(0, 0, 0), Vec3(0, 1, 0), 20.0, aspect_ratio, 0.1, 10.0);
+
+    std::vector<Ray> rays;
+    const size_t ray_count = 200000;
+    for (size_t i = 0; i < ray_count; i++)
+        rays.push_back(cam.get_ray(random_double(), random_double()));
+
+    std::cout << "main scene: " << list.objects.size() << " spheres in "
+              << compact.block_count() << " blocks\n";
+    auto c = compare(list, compact, rays);
+    report(c);
+
+    int status = 0;
+    if (c.mismatches > max_mismatch_fraction * c.rays) {
+        std::cerr << "FAILED: more than " << max_mismatch_fraction * 100
+                  << "% of rays hit a different material\n";
+        status = 1;
+    }
+
+    // Memory per object must beat the current layout from a single sphere up to dense
+    // scenes, including sparse scenes with widely varying radii.
+    std::vector<CompactSphereList> scenes;
+    scenes.push_back(std::move(compact));
+    const size_t counts[] = { 1, 2, 200, 1000, 20000 };
+    for (auto n : counts) {
+        scenes.push_back(pack(random_spheres(n, 100.0, 0.1, 1.0)));
+        scenes.push_back(pack(random_spheres(n, 1000.0, 0.001, 10.0)));
+    }
+
+    for (const auto& scene : scenes) {
+        auto bytes = compact_bytes_per_object(scene);
+        if (bytes > list_bytes_per_object()) {
+            std::cerr << "FAILED: " << scene.size() << " spheres use " << bytes
+                      << " bytes/object, more than " << list_bytes_per_object() << '\n';
+            status = 1;
+        }
+    }
+    return status;
+}
+
+void usage() {
+    std::cerr << "Usage: scene_bench [object_count] [ray_count]\n"
+              << "       scene_bench --check\n";
+}
+
+// Parse a positive count, rejecting zero, signs and trailing characters.
+bool parse_count(const char* arg, size_t& count) {
+    if (*arg < '0' || *arg > '9')
+        return false;
+    char* end = nullptr;
+    auto value = std::strtoull(arg, &end, 10);
+    if (*end != '\0' || value == 0)
+        return false;
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--check") == 0)
+        return check_main_scene();
+
+    size_t object_count = 20000;
+    size_t ray_count = 20000;
+    if (argc > 3 || (argc > 1 && !parse_count(argv[1], object_count))
+        || (argc > 2 && !parse_count(argv[2], ray_count))) {
+        usage();
+        return 1;
+    }
+    const double scene_extent = 100.0;
+
+    // Build both layouts from the same random spheres
+    HittableList list = random_spheres(object_count, scene_extent, 0.1, 1.0);
+    CompactSphereList compact = pack(list);
+
+    std::vector<Ray> rays;
+    rays.reserve(ray_count);
+    for (size_t i = 0; i < ray_count; i++)
+        rays.push_back(Ray(Vec3::random(-scene_extent, scene_extent), random_unit_vector()));
+
+    const double list_bytes = list_bytes_per_object();
+    const double compact_bytes = compact_bytes_per_object(compact);
+
+    std::cerr << "Tracing " << ray_count << " rays against " << object_count << " spheres...\n";
+    auto list_rate = rays_per_sec(list, rays);
+    auto compact_rate = rays_per_sec(compact, rays);
+
+    std::cout << "layout               bytes/object   rays/sec\n";
+    std::cout << "HittableList<Sphere> " << list_bytes << "\t\t" << list_rate << '\n';
+    std::cout << "CompactSphereList    " << compact_bytes << "\t\t" << compact_rate << '\n';
+    std::cout << "speedup: " << compact_rate / list_rate << "x\n";
+    report(compare(list, compact, rays));
+
+    return 0;
+}